@@ -28,13 +28,19 @@ CUDAPolisher::CUDAPolisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
     std::unique_ptr<bioparser::Parser<Overlap>> oparser,
     std::unique_ptr<bioparser::Parser<Sequence>> tparser,
     PolisherType type, bool haplotype, double min_confidence, double min_support,
-    uint32_t num_prune, uint32_t window_length, double quality_threshold,
-    double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
+    uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+    double quality_threshold,
+    double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+    int8_t match, int8_t mismatch, int8_t gap,
+    int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+    uint32_t local_xdrop,
+    uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
     uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
     uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width)
         : Polisher(std::move(sparser), std::move(oparser), std::move(tparser),
-                type, haplotype, min_confidence, min_support, num_prune, window_length, quality_threshold, error_threshold, trim,
-                match, mismatch, gap, num_threads)
+                type, haplotype, min_confidence, min_support, num_prune, window_length, adaptive_windows, quality_threshold, error_threshold, trim, max_depth, min_agreement,
+                match, mismatch, gap,
+                local_match, local_mismatch, local_gap, local_xdrop, band_width, packed_traceback, max_engine_memory, num_threads, "", "")
         , cudapoa_batches_(cudapoa_batches)
         , cudaaligner_batches_(cudaaligner_batches)
         , gap_(gap)
@@ -359,11 +365,10 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
         for (uint64_t i = 0; i < windows_.size(); ++i) {
             if (window_consensus_status_.at(i) == false)
             {
+                // windows over the engine memory limit keep their backbone
                 thread_failed_windows.emplace_back(thread_pool_->Submit(
                             [&](uint64_t j) -> bool {
-                            auto it = thread_pool_->thread_ids().find(std::this_thread::get_id());
-                            return window_consensus_status_.at(j) = windows_[j]->generate_consensus(
-                                    alignment_engines_[it->second], trim_);
+                            return window_consensus_status_.at(j) = generate_consensus(j, false);
                             }, i));
             }
         }
@@ -377,6 +382,14 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
             logger_->log("[racon::CUDAPolisher::polish] polished remaining windows on CPU");
             logger_->log();
         }
+        if (max_engine_memory_ != 0) {
+            uint64_t num_skipped_windows = 0;
+            for (const auto& it: num_skipped_windows_) {
+                num_skipped_windows += it;
+            }
+            fprintf(stderr, "[racon::CUDAPolisher::polish] windows over the "
+                "engine memory limit: %lu\n", num_skipped_windows);
+        }
 
         // Collect results from all windows into final output.
         std::string polished_data = "";
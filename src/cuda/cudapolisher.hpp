@@ -26,9 +26,15 @@ public:
     friend std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         const std::string& overlaps_path, const std::string& target_path,
         PolisherType type, bool haplotype,double min_confidence,double min_support,
-        uint32_t num_prune, uint32_t window_length, double quality_threshold,
-        double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-        uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
+        uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+        double quality_threshold,
+        double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+        int8_t match, int8_t mismatch, int8_t gap,
+        int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+        uint32_t local_xdrop,
+        uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+        uint32_t num_threads, const std::string& save_graphs_path,
+        const std::string& load_graphs_path, uint32_t cudapoa_batches, bool cuda_banded_alignment,
         uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
 
 protected:
@@ -36,8 +42,13 @@ protected:
         std::unique_ptr<bioparser::Parser<Overlap>> oparser,
         std::unique_ptr<bioparser::Parser<Sequence>> tparser,
         PolisherType type, bool haplotype,double min_confidence,double min_support,
-        uint32_t num_prune, uint32_t window_length, double quality_threshold,
-        double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
+        uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+        double quality_threshold,
+        double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+        int8_t match, int8_t mismatch, int8_t gap,
+        int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+        uint32_t local_xdrop,
+        uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
         uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
         uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
     CUDAPolisher(const CUDAPolisher&) = delete;
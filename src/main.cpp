@@ -13,19 +13,43 @@
 #endif
 static const int32_t CUDAALIGNER_INPUT_CODE = 10000;
 static const int32_t CUDAALIGNER_BAND_WIDTH_INPUT_CODE = 10001;
+static const int32_t SAVE_GRAPHS_INPUT_CODE = 10002;
+static const int32_t LOAD_GRAPHS_INPUT_CODE = 10003;
+static const int32_t BAND_WIDTH_INPUT_CODE = 10004;
+static const int32_t PACKED_TRACEBACK_INPUT_CODE = 10005;
+static const int32_t LOCAL_MATCH_INPUT_CODE = 10006;
+static const int32_t LOCAL_MISMATCH_INPUT_CODE = 10007;
+static const int32_t LOCAL_GAP_INPUT_CODE = 10008;
+static const int32_t LOCAL_XDROP_INPUT_CODE = 10009;
+static const int32_t MAX_ENGINE_MEMORY_INPUT_CODE = 10010;
+static const int32_t MAX_DEPTH_INPUT_CODE = 10011;
+static const int32_t MIN_AGREEMENT_INPUT_CODE = 10012;
+static const int32_t ADAPTIVE_WINDOWS_INPUT_CODE = 10013;
 
 static struct option options[] = {
     {"include-unpolished", no_argument, 0, 'u'},
     {"fragment-correction", no_argument, 0, 'f'},
     {"haplotype", no_argument, 0, 'p'}, // haplotype-aware error correction 
     {"window-length", required_argument, 0, 'w'},
+    {"adaptive-windows", no_argument, 0, ADAPTIVE_WINDOWS_INPUT_CODE},
     {"quality-threshold", required_argument, 0, 'q'},
     {"error-threshold", required_argument, 0, 'e'},
     {"no-trimming", no_argument, 0, 'T'},
+    {"max-depth", required_argument, 0, MAX_DEPTH_INPUT_CODE},
+    {"min-agreement", required_argument, 0, MIN_AGREEMENT_INPUT_CODE},
     {"match", required_argument, 0, 'm'},
     {"mismatch", required_argument, 0, 'x'},
     {"gap", required_argument, 0, 'g'},
+    {"local-match", required_argument, 0, LOCAL_MATCH_INPUT_CODE},
+    {"local-mismatch", required_argument, 0, LOCAL_MISMATCH_INPUT_CODE},
+    {"local-gap", required_argument, 0, LOCAL_GAP_INPUT_CODE},
+    {"local-xdrop", required_argument, 0, LOCAL_XDROP_INPUT_CODE},
+    {"band-width", required_argument, 0, BAND_WIDTH_INPUT_CODE},
+    {"packed-traceback", no_argument, 0, PACKED_TRACEBACK_INPUT_CODE},
+    {"max-engine-memory", required_argument, 0, MAX_ENGINE_MEMORY_INPUT_CODE},
     {"threads", required_argument, 0, 't'},
+    {"save-graphs", required_argument, 0, SAVE_GRAPHS_INPUT_CODE},
+    {"load-graphs", required_argument, 0, LOAD_GRAPHS_INPUT_CODE},
     {"version", no_argument, 0, 'v'},
     {"help", no_argument, 0, 'h'},
 #ifdef CUDA_ENABLED
@@ -44,13 +68,23 @@ int main(int argc, char** argv) {
     std::vector<std::string> input_paths;
 
     uint32_t window_length = 500;
+    bool adaptive_windows = false;
     double quality_threshold = 10.0;
     double error_threshold = 0.3;
     bool trim = true;
+    uint32_t max_depth = 0;
+    double min_agreement = 0;
 
     int8_t match = 3;
     int8_t mismatch = -5;
     int8_t gap = -4;
+    int8_t local_match = 3;
+    int8_t local_mismatch = -5;
+    int8_t local_gap = -4;
+    uint32_t local_xdrop = 0;
+    uint32_t band_width = 0;
+    bool packed_traceback = false;
+    uint64_t max_engine_memory = 0;
     uint32_t type = 0;
 
     bool drop_unpolished_sequences = true;
@@ -60,6 +94,9 @@ int main(int argc, char** argv) {
     uint32_t num_prune = 3;
     uint32_t num_threads = 1;
 
+    std::string save_graphs_path = "";
+    std::string load_graphs_path = "";
+
     uint32_t cudapoa_batches = 0;
     uint32_t cudaaligner_batches = 0;
     uint32_t cudaaligner_band_width = 0;
@@ -94,6 +131,9 @@ int main(int argc, char** argv) {
             case 'w':
                 window_length = atoi(optarg);
                 break;
+            case ADAPTIVE_WINDOWS_INPUT_CODE:
+                adaptive_windows = true;
+                break;
             case 'q':
                 quality_threshold = atof(optarg);
                 break;
@@ -103,6 +143,12 @@ int main(int argc, char** argv) {
             case 'T':
                 trim = false;
                 break;
+            case MAX_DEPTH_INPUT_CODE:
+                max_depth = atoi(optarg);
+                break;
+            case MIN_AGREEMENT_INPUT_CODE:
+                min_agreement = atof(optarg);
+                break;
             case 'm':
                 match = atoi(optarg);
                 break;
@@ -112,9 +158,36 @@ int main(int argc, char** argv) {
             case 'g':
                 gap = atoi(optarg);
                 break;
+            case LOCAL_MATCH_INPUT_CODE:
+                local_match = atoi(optarg);
+                break;
+            case LOCAL_MISMATCH_INPUT_CODE:
+                local_mismatch = atoi(optarg);
+                break;
+            case LOCAL_GAP_INPUT_CODE:
+                local_gap = atoi(optarg);
+                break;
+            case LOCAL_XDROP_INPUT_CODE:
+                local_xdrop = atoi(optarg);
+                break;
+            case BAND_WIDTH_INPUT_CODE:
+                band_width = atoi(optarg);
+                break;
+            case PACKED_TRACEBACK_INPUT_CODE:
+                packed_traceback = true;
+                break;
+            case MAX_ENGINE_MEMORY_INPUT_CODE:
+                max_engine_memory = atoll(optarg) << 20;
+                break;
             case 't':
                 num_threads = atoi(optarg);
                 break;
+            case SAVE_GRAPHS_INPUT_CODE:
+                save_graphs_path = optarg;
+                break;
+            case LOAD_GRAPHS_INPUT_CODE:
+                load_graphs_path = optarg;
+                break;
             case 'v':
                 printf("%s\n", VERSION);
                 exit(0);
@@ -154,6 +227,17 @@ int main(int argc, char** argv) {
         input_paths.emplace_back(argv[i]);
     }
 
+    // input files are not used when windows are read from a graph store
+    if (!load_graphs_path.empty()) {
+        if (!input_paths.empty()) {
+            fprintf(stderr, "[racon::] error: input files are not used with "
+                "--load-graphs!\n");
+            help();
+            exit(1);
+        }
+        input_paths.resize(3);
+    }
+
     if (input_paths.size() < 3) {
         fprintf(stderr, "[racon::] error: missing input file(s)!\n");
         help();
@@ -163,9 +247,11 @@ int main(int argc, char** argv) {
     auto polisher = racon::createPolisher(input_paths[0], input_paths[1],
         input_paths[2], type == 0 ? racon::PolisherType::kC :
         racon::PolisherType::kF,haplotype, min_confidence, min_support, 
-        num_prune, window_length, quality_threshold,
-        error_threshold, trim, match, mismatch, gap, num_threads,
-        cudapoa_batches, cuda_banded_alignment, cudaaligner_batches,
+        num_prune, window_length, adaptive_windows, quality_threshold,
+        error_threshold, trim, max_depth, min_agreement, match, mismatch, gap,
+        local_match, local_mismatch, local_gap, local_xdrop, band_width, packed_traceback, max_engine_memory,
+        num_threads,
+        save_graphs_path, load_graphs_path, cudapoa_batches, cuda_banded_alignment, cudaaligner_batches,
         cudaaligner_band_width);
 
     polisher->initialize();
@@ -215,6 +301,11 @@ void help() {
         "        -w, --window-length <int>\n"
         "            default: 500\n"
         "            size of window on which POA is performed\n"
+        "        --adaptive-windows\n"
+        "            sizes windows per target between half and the full window\n"
+        "            length so that each takes about as much POA work as a\n"
+        "            window of full length at the typical overlap depth and\n"
+        "            error, i.e. shorter windows in deeper or noisier regions\n"
         "        -q, --quality-threshold <float>\n"
         "            default: 10.0\n"
         "            threshold for average base quality of windows used in POA\n"
@@ -223,6 +314,16 @@ void help() {
         "            maximum allowed error rate used for filtering overlaps\n"
         "        --no-trimming\n"
         "            disables consensus trimming at window ends\n"
+        "        --max-depth <int>\n"
+        "            default: 0\n"
+        "            downsamples the layers of each window to the given coverage,\n"
+        "            keeping full-spanning layers of high quality and low error\n"
+        "            first and both strands alike (0 keeps all layers)\n"
+        "        --min-agreement <float>\n"
+        "            default: 0\n"
+        "            skips POA in windows where at least this fraction of layers\n"
+        "            (above 0.5 for the majority) is identical to the backbone,\n"
+        "            which is kept as consensus (0 disables the check)\n"
         "        -m, --match <int>\n"
         "            default: 3\n"
         "            score for matching bases\n"
@@ -232,9 +333,49 @@ void help() {
         "        -g, --gap <int>\n"
         "            default: -4\n"
         "            gap penalty (must be negative)\n"
+        "        --local-match <int>\n"
+        "            default: 3\n"
+        "            with --haplotype, score for matching bases in the local\n"
+        "            alignments to pruned graphs\n"
+        "        --local-mismatch <int>\n"
+        "            default: -5\n"
+        "            with --haplotype, score for mismatching bases in the local\n"
+        "            alignments to pruned graphs\n"
+        "        --local-gap <int>\n"
+        "            default: -4\n"
+        "            with --haplotype, gap penalty in the local alignments to\n"
+        "            pruned graphs (must be negative)\n"
+        "        --local-xdrop <int>\n"
+        "            default: 0\n"
+        "            with --haplotype, stops extending a local alignment to a\n"
+        "            pruned graph once its best row score falls more than the\n"
+        "            given value below the best score seen (0 disables X-drop)\n"
+        "        --band-width <int>\n"
+        "            default: 0\n"
+        "            restricts POA to columns within the given distance of the\n"
+        "            diagonal implied by node ranks, widening the band while the\n"
+        "            alignment touches its edges (0 disables banding)\n"
+        "        --packed-traceback\n"
+        "            keeps only two bits per POA matrix cell (and the score rows\n"
+        "            still needed) for the traceback, which lowers memory usage\n"
+        "            about eightfold at a small cost in speed\n"
+        "        --max-engine-memory <int>\n"
+        "            default: 0\n"
+        "            megabytes of POA matrices each alignment engine (one or two\n"
+        "            per thread) may hold, alignments that would need more use\n"
+        "            the packed traceback and windows that still do not fit keep\n"
+        "            their backbone (0 disables the limit)\n"
         "        -t, --threads <int>\n"
         "            default: 1\n"
         "            number of threads\n"
+        "        --save-graphs <file>\n"
+        "            with --haplotype, writes the window graphs before pruning\n"
+        "            to file, together with the window layers\n"
+        "        --load-graphs <file>\n"
+        "            with --haplotype, reads windows and their graphs from a file\n"
+        "            written with --save-graphs and reruns only the pruning and\n"
+        "            sequence correction (input files must then be omitted, while\n"
+        "            -d, -s, -k and the alignment scores apply as usual)\n"
         "        --version\n"
         "            prints the version number\n"
         "        -h, --help\n"
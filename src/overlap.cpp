@@ -177,7 +177,7 @@ void Overlap::transmute(const std::vector<std::unique_ptr<Sequence>>& sequences,
 }
 
 void Overlap::find_breaking_points(const std::vector<std::unique_ptr<Sequence>>& sequences,
-    uint32_t window_length) {
+    const std::vector<uint32_t>& window_starts) {
 
     if (!is_transmuted_) {
         fprintf(stderr, "[racon::Overlap::find_breaking_points] error: "
@@ -197,7 +197,7 @@ void Overlap::find_breaking_points(const std::vector<std::unique_ptr<Sequence>>&
         align_overlaps(q, q_end_ - q_begin_, t, t_end_ - t_begin_);
     }
 
-    find_breaking_points_from_cigar(window_length);
+    find_breaking_points_from_cigar(window_starts);
 
     std::string().swap(cigar_);
 }
@@ -223,13 +223,16 @@ void Overlap::align_overlaps(const char* q, uint32_t q_length, const char* t, ui
     edlibFreeAlignResult(result);
 }
 
-void Overlap::find_breaking_points_from_cigar(uint32_t window_length)
+void Overlap::find_breaking_points_from_cigar(const std::vector<uint32_t>& window_starts)
 {
     // find breaking points from cigar
     std::vector<int32_t> window_ends;
-    for (uint32_t i = 0; i < t_end_; i += window_length) {
-        if (i > t_begin_) {
-            window_ends.emplace_back(i - 1);
+    for (const auto& it: window_starts) {
+        if (it >= t_end_) {
+            break;
+        }
+        if (it > t_begin_) {
+            window_ends.emplace_back(it - 1);
         }
     }
     window_ends.emplace_back(t_end_ - 1);
@@ -41,6 +41,14 @@ public:
         return t_id_;
     }
 
+    uint32_t t_begin() const {
+        return t_begin_;
+    }
+
+    uint32_t t_end() const {
+        return t_end_;
+    }
+
     uint32_t strand() const {
         return strand_;
     }
@@ -69,8 +77,9 @@ public:
         return breaking_points_;
     }
 
+    // window_starts are the sorted window start positions on the target
     void find_breaking_points(const std::vector<std::unique_ptr<Sequence>>& sequences,
-        uint32_t window_length);
+        const std::vector<uint32_t>& window_starts);
 
     friend bioparser::MhapParser<Overlap>;
     friend bioparser::PafParser<Overlap>;
@@ -97,7 +106,7 @@ private:
     Overlap();
     Overlap(const Overlap&) = delete;
     const Overlap& operator=(const Overlap&) = delete;
-    virtual void find_breaking_points_from_cigar(uint32_t window_length);
+    virtual void find_breaking_points_from_cigar(const std::vector<uint32_t>& window_starts);
     virtual void align_overlaps(const char* q, uint32_t q_len, const char* t, uint32_t t_len);
 
     std::string q_name_;
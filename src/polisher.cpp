@@ -5,8 +5,11 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <unordered_set>
 #include <iostream>
+#include <fstream>
+#include <stdexcept>
 
 #include "overlap.hpp"
 #include "sequence.hpp"
@@ -24,10 +27,15 @@
 #include "bioparser/sam_parser.hpp"
 #include "thread_pool/thread_pool.hpp"
 #include "spoa/spoa.hpp"
+#include "cereal/archives/binary.hpp"
+#include "cereal/types/string.hpp"
+#include "cereal/types/vector.hpp"
 
 namespace racon {
 
 constexpr uint32_t kChunkSize = 1024 * 1024 * 1024; // ~ 1GB
+constexpr uint32_t kGraphsVersion = 1;
+constexpr uint32_t kEngineMemoryRound = 64; // windows
 
 template<class T>
 uint64_t shrinkToFit(std::vector<std::unique_ptr<T>>& src, uint64_t begin) {
@@ -59,9 +67,15 @@ uint64_t shrinkToFit(std::vector<std::unique_ptr<T>>& src, uint64_t begin) {
 std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
     const std::string& overlaps_path, const std::string& target_path,
     PolisherType type,bool haplotype, double min_confidence, double min_support,
-    uint32_t num_prune, uint32_t window_length, double quality_threshold,
-    double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-    uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
+    uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+    double quality_threshold,
+    double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+    int8_t match, int8_t mismatch, int8_t gap,
+    int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+    uint32_t local_xdrop,
+    uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+    uint32_t num_threads, const std::string& save_graphs_path,
+    const std::string& load_graphs_path, uint32_t cudapoa_batches, bool cuda_banded_alignment,
     uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width) {
 
     if (type != PolisherType::kC && type != PolisherType::kF) {
@@ -74,6 +88,28 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         exit(1);
     }
 
+    if ((!save_graphs_path.empty() || !load_graphs_path.empty()) && !haplotype) {
+        fprintf(stderr, "[racon::createPolisher] error: "
+            "graph stores are only supported in haplotype mode!\n");
+        exit(1);
+    }
+
+    if ((!save_graphs_path.empty() || !load_graphs_path.empty()) &&
+        (cudapoa_batches > 0 || cudaaligner_batches > 0)) {
+        fprintf(stderr, "[racon::createPolisher] error: "
+            "graph stores are not supported with CUDA!\n");
+        exit(1);
+    }
+
+    if (!load_graphs_path.empty()) {
+        // targets, windows and their graphs are read by initialize
+        return std::unique_ptr<Polisher>(new Polisher(nullptr, nullptr,
+            nullptr, type, haplotype, min_confidence, min_support, num_prune,
+            window_length, adaptive_windows, quality_threshold, error_threshold, trim, max_depth, min_agreement, match,
+            mismatch, gap,
+            local_match, local_mismatch, local_gap, local_xdrop, band_width, packed_traceback, max_engine_memory, num_threads, save_graphs_path, load_graphs_path));
+    }
+
     std::unique_ptr<bioparser::Parser<Sequence>> sparser = nullptr,
         tparser = nullptr;
     std::unique_ptr<bioparser::Parser<Overlap>> oparser = nullptr;
@@ -144,7 +180,8 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         return std::unique_ptr<Polisher>(new CUDAPolisher(std::move(sparser),
                     std::move(oparser), std::move(tparser), type, haplotype,
                     min_confidence, min_support, num_prune, window_length,
-                    quality_threshold, error_threshold, trim, match, mismatch, gap,
+                    adaptive_windows, quality_threshold, error_threshold, trim, max_depth, min_agreement, match, mismatch, gap,
+                    local_match, local_mismatch, local_gap, local_xdrop, band_width, packed_traceback, max_engine_memory,
                     num_threads, cudapoa_batches, cuda_banded_alignment, cudaaligner_batches,
                     cudaaligner_band_width));
 #else
@@ -162,8 +199,9 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         return std::unique_ptr<Polisher>(new Polisher(std::move(sparser),
                     std::move(oparser), std::move(tparser), type, haplotype,
                     min_confidence, min_support, num_prune, window_length,
-                    quality_threshold, error_threshold, trim, match, mismatch, gap,
-                    num_threads));
+                    adaptive_windows, quality_threshold, error_threshold, trim, max_depth, min_agreement, match, mismatch, gap,
+                    local_match, local_mismatch, local_gap, local_xdrop, band_width, packed_traceback, max_engine_memory,
+                    num_threads, save_graphs_path, load_graphs_path));
     }
 }
 
@@ -171,22 +209,59 @@ Polisher::Polisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
     std::unique_ptr<bioparser::Parser<Overlap>> oparser,
     std::unique_ptr<bioparser::Parser<Sequence>> tparser,
     PolisherType type,bool haplotype, double min_confidence, double min_support,
-    uint32_t num_prune, uint32_t window_length, double quality_threshold,
-    double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-    uint32_t num_threads)
+    uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+    double quality_threshold,
+    double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+    int8_t match, int8_t mismatch, int8_t gap,
+    int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+    uint32_t local_xdrop,
+    uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+    uint32_t num_threads, const std::string& save_graphs_path,
+    const std::string& load_graphs_path)
         : sparser_(std::move(sparser)), oparser_(std::move(oparser)),
         tparser_(std::move(tparser)), type_(type),haplotype_(haplotype), 
         min_confidence_(min_confidence), min_support_(min_support), num_prune_(num_prune),
         quality_threshold_(quality_threshold), error_threshold_(error_threshold), trim_(trim),
-        alignment_engines_(), sequences_(), dummy_quality_(window_length, '!'),
-        window_length_(window_length), windows_(),
+        max_depth_(max_depth), min_agreement_(min_agreement),
+        save_graphs_path_(save_graphs_path), load_graphs_path_(load_graphs_path),
+        alignment_engines_(), local_alignment_engines_(),
+        max_engine_memory_(max_engine_memory), engine_memories_(),
+        local_engine_memories_(), engine_memory_peaks_(num_threads, 0),
+        num_skipped_windows_(num_threads, 0),
+        num_agreeing_windows_(num_threads, 0), sequences_(), dummy_quality_(window_length, '!'),
+        window_length_(window_length), adaptive_windows_(adaptive_windows),
+        window_starts_(), windows_(),
         thread_pool_(std::make_shared<thread_pool::ThreadPool>(num_threads)),
         logger_(new Logger()) {
 
     for (uint32_t i = 0; i < num_threads; ++i) {
         alignment_engines_.emplace_back(spoa::AlignmentEngine::Create(
             spoa::AlignmentType::kNW, match, mismatch, gap));
+        alignment_engines_.back()->set_packed_traceback(packed_traceback);
         alignment_engines_.back()->Prealloc(window_length_, 5);
+        // the preallocated size is the first target, even over the cap
+        engine_memories_.push_back({0, alignment_engines_.back()->memory(), 0});
+        alignment_engines_.back()->set_band_width(band_width);
+        alignment_engines_.back()->set_max_memory(max_engine_memory_);
+        if (max_engine_memory_ != 0) {
+            alignment_engines_.back()->Shrink(max_engine_memory_);
+        }
+
+        // reused across windows, so their matrices grow to the largest
+        // pruned graph seen by the thread instead of starting anew
+        if (haplotype_) {
+            local_alignment_engines_.emplace_back(spoa::AlignmentEngine::Create(
+                spoa::AlignmentType::kSW, local_match, local_mismatch, local_gap));
+            local_alignment_engines_.back()->set_packed_traceback(packed_traceback);
+            local_alignment_engines_.back()->set_xdrop(local_xdrop);
+            local_alignment_engines_.back()->Prealloc(window_length_, 5);
+            local_engine_memories_.push_back({0,
+                local_alignment_engines_.back()->memory(), 0});
+            local_alignment_engines_.back()->set_max_memory(max_engine_memory_);
+            if (max_engine_memory_ != 0) {
+                local_alignment_engines_.back()->Shrink(max_engine_memory_);
+            }
+        }
     }
 }
 
@@ -202,6 +277,11 @@ void Polisher::initialize() {
         return;
     }
 
+    if (!load_graphs_path_.empty()) {
+        load_graphs();
+        return;
+    }
+
     logger_->log();
 
     tparser_->Reset();
@@ -382,16 +462,21 @@ void Polisher::initialize() {
         it.wait();
     }
 
+    find_window_starts(targets_size, overlaps);
+
     find_overlap_breaking_points(overlaps);
 
     logger_->log();
 
     std::vector<uint64_t> id_to_first_window_id(targets_size + 1, 0);
     for (uint64_t i = 0; i < targets_size; ++i) {
+        const auto& window_starts = window_starts_[i];
         uint32_t k = 0;
-        for (uint32_t j = 0; j < sequences_[i]->data().size(); j += window_length_, ++k) {
+        for (; k < window_starts.size(); ++k) {
 
-            uint32_t length = std::min(j + window_length_,
+            uint32_t j = window_starts[k];
+            uint32_t length = (k + 1 < window_starts.size() ?
+                window_starts[k + 1] :
                 static_cast<uint32_t>(sequences_[i]->data().size())) - j;
 
             windows_.emplace_back(createWindow(i, k, window_type,
@@ -417,6 +502,7 @@ void Polisher::initialize() {
                 continue;
             }
 
+            double accuracy = 1 - overlaps[i]->error();
             if (!sequence->quality().empty() ||
                 !sequence->reverse_quality().empty()) {
 
@@ -431,12 +517,15 @@ void Polisher::initialize() {
                 if (average_quality < quality_threshold_) {
                     continue;
                 }
+                accuracy *= 1 - std::pow(10, -average_quality / 10);
             }
 
-            uint64_t window_id = id_to_first_window_id[overlaps[i]->t_id()] +
-                breaking_points[j].first / window_length_;
-            uint32_t window_start = (breaking_points[j].first / window_length_) *
-                window_length_;
+            const auto& window_starts = window_starts_[overlaps[i]->t_id()];
+            uint32_t rank = std::upper_bound(window_starts.begin(),
+                window_starts.end(), breaking_points[j].first) -
+                window_starts.begin() - 1;
+            uint64_t window_id = id_to_first_window_id[overlaps[i]->t_id()] + rank;
+            uint32_t window_start = window_starts[rank];
 
             const char* data = overlaps[i]->strand() ?
                 &(sequence->reverse_complement()[breaking_points[j].second]) :
@@ -455,22 +544,220 @@ void Polisher::initialize() {
             windows_[window_id]->add_layer(data, data_length,
                 quality, quality_length,
                 breaking_points[j].first - window_start,
-                breaking_points[j + 1].first - window_start - 1);
+                breaking_points[j + 1].first - window_start - 1,
+                overlaps[i]->strand(), accuracy);
         }
 
         overlaps[i].reset();
     }
+    std::vector<std::vector<uint32_t>>().swap(window_starts_);
+
+    if (max_depth_ != 0) {
+        uint64_t num_kept_layers = 0, num_dropped_layers = 0;
+        for (const auto& it: windows_) {
+            uint32_t num_dropped = it->downsample(max_depth_);
+            if (num_dropped != 0) {
+                fprintf(stderr, "[racon::Polisher::initialize] window %u of "
+                    "sequence %lu: kept %u, dropped %u layers\n", it->rank(),
+                    it->id(), it->num_layers(), num_dropped);
+            }
+            num_kept_layers += it->num_layers();
+            num_dropped_layers += num_dropped;
+        }
+        fprintf(stderr, "[racon::Polisher::initialize] downsampled windows to "
+            "depth %u: kept %lu, dropped %lu layers\n", max_depth_,
+            num_kept_layers, num_dropped_layers);
+    }
 
     logger_->log("[racon::Polisher::initialize] transformed data into windows");
 }
 
+void Polisher::load_graphs() {
+
+    logger_->log();
+
+    std::ifstream is(load_graphs_path_, std::ios::binary);
+    if (!is.is_open()) {
+        fprintf(stderr, "[racon::Polisher::load_graphs] error: "
+            "unable to open file %s!\n", load_graphs_path_.c_str());
+        exit(1);
+    }
+
+    std::string magic;
+    uint32_t version = 0;
+    uint8_t type = 0;
+    std::vector<std::string> names;
+    uint64_t num_windows = 0;
+    try {
+        cereal::BinaryInputArchive archive(is);
+        archive(magic, version, type, names, targets_coverages_, num_windows);
+    } catch (const std::exception&) {
+        magic.clear();
+    }
+    if (magic != "racon-graphs" || version != kGraphsVersion ||
+        (type != static_cast<uint8_t>(PolisherType::kC) &&
+         type != static_cast<uint8_t>(PolisherType::kF)) ||
+        names.size() != targets_coverages_.size()) {
+        fprintf(stderr, "[racon::Polisher::load_graphs] error: "
+            "file %s is not a valid graph store!\n", load_graphs_path_.c_str());
+        exit(1);
+    }
+
+    // the store decides whether the targets were contigs or fragments
+    type_ = static_cast<PolisherType>(type);
+    for (const auto& it: names) {
+        sequences_.emplace_back(createSequence(it, ""));
+    }
+
+    windows_.reserve(num_windows);
+    for (uint64_t i = 0; i < num_windows; ++i) {
+        try {
+            windows_.emplace_back(loadWindow(is));
+        } catch (const std::exception&) {
+            fprintf(stderr, "[racon::Polisher::load_graphs] error: "
+                "file %s is truncated!\n", load_graphs_path_.c_str());
+            exit(1);
+        }
+        if (windows_.back()->id() >= sequences_.size()) {
+            fprintf(stderr, "[racon::Polisher::load_graphs] error: "
+                "file %s is not a valid graph store!\n", load_graphs_path_.c_str());
+            exit(1);
+        }
+    }
+
+    logger_->log("[racon::Polisher::initialize] loaded windows and graphs");
+}
+
+void Polisher::find_window_starts(uint64_t targets_size,
+    const std::vector<std::unique_ptr<Overlap>>& overlaps) {
+
+    window_starts_.resize(targets_size);
+
+    if (!adaptive_windows_) {
+        for (uint64_t i = 0; i < targets_size; ++i) {
+            for (uint32_t j = 0; j < sequences_[i]->data().size(); j += window_length_) {
+                window_starts_[i].emplace_back(j);
+            }
+        }
+        return;
+    }
+
+    // each layer of a window is aligned to a graph which gains nodes with
+    // every error of the layers before it, so a window of length L at depth d
+    // and error rate e costs roughly L^2 * d * (1 + e * d), i.e. L times the
+    // sum of work(x) = d(x) + E(x) * d(x) over its positions, where E(x) is
+    // the summed overlap error at x; windows are cut where this reaches the
+    // cost of a window_length_ long window at the typical work per position
+    // (averaged over the work, so that poorly covered target ends do not
+    // lower it), but are never made longer than window_length_ as POA loses
+    // accuracy in long windows with little coverage
+    std::vector<std::vector<uint64_t>> target_overlaps(targets_size);
+    for (uint64_t i = 0; i < overlaps.size(); ++i) {
+        target_overlaps[overlaps[i]->t_id()].emplace_back(i);
+    }
+
+    std::vector<std::vector<float>> works(targets_size);
+    std::vector<double> works_sums(targets_size, 0);
+    std::vector<double> works_squares_sums(targets_size, 0);
+
+    std::vector<std::future<void>> thread_futures;
+    for (uint64_t i = 0; i < targets_size; ++i) {
+        thread_futures.emplace_back(thread_pool_->Submit(
+            [&](uint64_t j) -> void {
+                uint32_t length = sequences_[j]->data().size();
+                std::vector<int32_t> depths(length + 1, 0);
+                std::vector<double> errors(length + 1, 0);
+                for (const auto& it: target_overlaps[j]) {
+                    const auto& overlap = overlaps[it];
+                    ++depths[overlap->t_begin()];
+                    --depths[overlap->t_end()];
+                    errors[overlap->t_begin()] += overlap->error();
+                    errors[overlap->t_end()] -= overlap->error();
+                }
+
+                works[j].resize(length);
+                int32_t depth = 0;
+                double error = 0;
+                for (uint32_t k = 0; k < length; ++k) {
+                    depth += depths[k];
+                    error += errors[k];
+                    works[j][k] = depth * (1 + std::max(error, 0.));
+                    works_sums[j] += works[j][k];
+                    works_squares_sums[j] += works[j][k] * works[j][k];
+                }
+            }, i));
+    }
+    for (const auto& it: thread_futures) {
+        it.wait();
+    }
+    thread_futures.clear();
+
+    double works_sum = 0, works_squares_sum = 0;
+    for (uint64_t i = 0; i < targets_size; ++i) {
+        works_sum += works_sums[i];
+        works_squares_sum += works_squares_sums[i];
+    }
+    double typical_work = works_sum == 0 ? 0 : works_squares_sum / works_sum;
+    double max_work = typical_work * window_length_ * window_length_;
+
+    uint32_t min_length = std::max(window_length_ / 2, 1U);
+    uint32_t max_length = window_length_;
+
+    for (uint64_t i = 0; i < targets_size; ++i) {
+        thread_futures.emplace_back(thread_pool_->Submit(
+            [&](uint64_t j) -> void {
+                uint32_t length = works[j].size();
+                for (uint32_t begin = 0, end = 0; begin < length; begin = end) {
+                    window_starts_[j].emplace_back(begin);
+
+                    double work = 0;
+                    for (end = begin; end < length && end - begin < max_length; ++end) {
+                        if (end - begin >= min_length &&
+                            (end - begin + 1) * (work + works[j][end]) > max_work) {
+                            break;
+                        }
+                        work += works[j][end];
+                    }
+                    // leave no window shorter than min_length at the end
+                    if (length - end < min_length) {
+                        if (length - begin <= max_length) {
+                            break;
+                        }
+                        end = begin + (length - begin) / 2;
+                    }
+                }
+                std::vector<float>().swap(works[j]);
+            }, i));
+    }
+    for (const auto& it: thread_futures) {
+        it.wait();
+    }
+
+    uint64_t num_windows = 0;
+    uint32_t min_window_length = -1, max_window_length = 0;
+    for (uint64_t i = 0; i < targets_size; ++i) {
+        const auto& window_starts = window_starts_[i];
+        num_windows += window_starts.size();
+        for (uint32_t j = 0; j < window_starts.size(); ++j) {
+            uint32_t length = (j + 1 < window_starts.size() ? window_starts[j + 1] :
+                static_cast<uint32_t>(sequences_[i]->data().size())) - window_starts[j];
+            min_window_length = std::min(min_window_length, length);
+            max_window_length = std::max(max_window_length, length);
+        }
+    }
+
+    fprintf(stderr, "[racon::Polisher::initialize] split targets into %lu "
+        "adaptive windows of length %u to %u\n", num_windows,
+        num_windows == 0 ? 0 : min_window_length, max_window_length);
+}
+
 void Polisher::find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps)
 {
     std::vector<std::future<void>> thread_futures;
     for (uint64_t i = 0; i < overlaps.size(); ++i) {
         thread_futures.emplace_back(thread_pool_->Submit(
             [&](uint64_t j) -> void {
-                overlaps[j]->find_breaking_points(sequences_, window_length_);
+                overlaps[j]->find_breaking_points(sequences_, window_starts_[overlaps[j]->t_id()]);
             }, i));
     }
 
@@ -488,37 +775,106 @@ void Polisher::find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>
     }
 }
 
+bool Polisher::generate_consensus(uint64_t i, bool store_graph) {
+
+    auto it = thread_pool_->thread_map().find(std::this_thread::get_id());
+    const auto& alignment_engine = alignment_engines_[it->second];
+
+    // the graph is not built, so there is nothing to store
+    if (min_agreement_ > 0 && !store_graph &&
+        windows_[i]->agrees_with_backbone(min_agreement_)) {
+        windows_[i]->keep_backbone();
+        ++num_agreeing_windows_[it->second];
+        return true;
+    }
+
+    bool is_polished = false;
+    try {
+        if (haplotype_) {
+            is_polished = windows_[i]->generate_consensus(alignment_engine,
+                local_alignment_engines_[it->second], trim_, haplotype_,
+                min_confidence_, min_support_, num_prune_, store_graph);
+        } else {
+            is_polished = windows_[i]->generate_consensus(alignment_engine,
+                trim_);
+        }
+    } catch (const spoa::MemoryLimitError& exception) {
+        fprintf(stderr, "[racon::Polisher::polish] warning: "
+            "window %u of sequence %lu keeps its backbone (%s)\n",
+            windows_[i]->rank(), windows_[i]->id(), exception.what());
+        windows_[i]->keep_backbone();
+        ++num_skipped_windows_[it->second];
+    }
+
+    uint64_t memory = shrink_engine(*alignment_engine,
+        engine_memories_[it->second]);
+    if (haplotype_) {
+        memory += shrink_engine(*local_alignment_engines_[it->second],
+            local_engine_memories_[it->second]);
+    }
+    engine_memory_peaks_[it->second] = std::max(
+        engine_memory_peaks_[it->second], memory);
+
+    return is_polished;
+}
+
+uint64_t Polisher::shrink_engine(spoa::AlignmentEngine& engine,
+    EngineMemory& recent) {
+
+    uint64_t memory = engine.memory();
+    uint64_t target = 2 * std::max(recent.current, recent.previous);
+    engine.Shrink(target);
+
+    // a shrunk engine counts at the target, so windows that keep growing
+    // double it each time instead of releasing the engine after each window
+    recent.current = std::max(recent.current, std::min(memory, target));
+    if (++recent.num_windows == kEngineMemoryRound) {
+        recent.previous = recent.current;
+        recent.current = 0;
+        recent.num_windows = 0;
+    }
+
+    return memory;
+}
+
 void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
     bool drop_unpolished_sequences) {
 
     logger_->log();
 
-    std::vector<std::future<bool>> thread_futures;
-    if(haplotype_){
-        for (uint64_t i = 0; i < windows_.size(); ++i) {
-        thread_futures.emplace_back(thread_pool_->Submit(
-            [&](uint64_t j) -> bool {
-                auto it = thread_pool_->thread_map().find(std::this_thread::get_id());  // NOLINT
-                return windows_[j]->generate_consensus(
-                    alignment_engines_[it->second], trim_, haplotype_,
-                    min_confidence_, min_support_, num_prune_);
-            }, i));
+    // window graphs are written before pruning, in window order, so that a
+    // later run can redo only the pruning with other parameters
+    std::ofstream graphs;
+    if (!save_graphs_path_.empty()) {
+        graphs.open(save_graphs_path_, std::ios::binary);
+        if (!graphs.is_open()) {
+            fprintf(stderr, "[racon::Polisher::polish] error: "
+                "unable to create file %s!\n", save_graphs_path_.c_str());
+            exit(1);
+        }
+
+        std::vector<std::string> names;
+        for (uint64_t i = 0; i < targets_coverages_.size(); ++i) {
+            names.emplace_back(sequences_[i]->name());
         }
+        cereal::BinaryOutputArchive archive(graphs);
+        archive(std::string("racon-graphs"), kGraphsVersion,
+            static_cast<uint8_t>(type_), names, targets_coverages_,
+            static_cast<uint64_t>(windows_.size()));
     }
-    else{
-        for (uint64_t i = 0; i < windows_.size(); ++i) {
+    bool store_graphs = graphs.is_open();
+
+    std::vector<std::future<bool>> thread_futures;
+    for (uint64_t i = 0; i < windows_.size(); ++i) {
         thread_futures.emplace_back(thread_pool_->Submit(
             [&](uint64_t j) -> bool {
-                auto it = thread_pool_->thread_map().find(std::this_thread::get_id());  // NOLINT
-                return windows_[j]->generate_consensus(
-                    alignment_engines_[it->second], trim_);
+                return generate_consensus(j, store_graphs);
             }, i));
-        }
     }
-    
 
     std::string polished_data = "";
     uint32_t num_polished_windows = 0;
+    std::vector<uint64_t> num_prune_rounds(std::max(num_prune_, 1U) + 1, 0);
 
     uint64_t logger_step = thread_futures.size() / 20;
 
@@ -527,6 +883,9 @@ void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
 
         num_polished_windows += thread_futures[i].get() == true ? 1 : 0;
         polished_data += windows_[i]->consensus();
+        if (store_graphs) {
+            windows_[i]->store(graphs);
+        }
 
         if (i == windows_.size() - 1 || windows_[i + 1]->rank() == 0) {
             double polished_ratio = num_polished_windows /
@@ -544,6 +903,7 @@ void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
             num_polished_windows = 0;
             polished_data.clear();
         }
+        ++num_prune_rounds[windows_[i]->num_prune_rounds()];
         windows_[i].reset();
 
         if (logger_step != 0 && (i + 1) % logger_step == 0 && (i + 1) / logger_step < 20) {
@@ -557,6 +917,47 @@ void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
         logger_->log("[racon::Polisher::polish] generated consensus");
     }
 
+    if (store_graphs) {
+        graphs.close();
+        if (graphs.fail()) {
+            fprintf(stderr, "[racon::Polisher::polish] error: "
+                "unable to write file %s!\n", save_graphs_path_.c_str());
+            exit(1);
+        }
+    }
+
+    if (haplotype_) {
+        fprintf(stderr, "[racon::Polisher::polish] windows per number of "
+            "pruning rounds:");
+        for (uint32_t i = 0; i < num_prune_rounds.size(); ++i) {
+            fprintf(stderr, " %u:%lu", i, num_prune_rounds[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "[racon::Polisher::polish] peak memory of the alignment "
+        "engines per thread (MB):");
+    for (const auto& it: engine_memory_peaks_) {
+        fprintf(stderr, " %.1f", it / 1048576.0);
+    }
+    fprintf(stderr, "\n");
+    if (min_agreement_ > 0) {
+        uint64_t num_agreeing_windows = 0;
+        for (const auto& it: num_agreeing_windows_) {
+            num_agreeing_windows += it;
+        }
+        fprintf(stderr, "[racon::Polisher::polish] windows agreeing with "
+            "their backbone (POA skipped): %lu\n", num_agreeing_windows);
+    }
+    if (max_engine_memory_ != 0) {
+        uint64_t num_skipped_windows = 0;
+        for (const auto& it: num_skipped_windows_) {
+            num_skipped_windows += it;
+        }
+        fprintf(stderr, "[racon::Polisher::polish] windows over the engine "
+            "memory limit: %lu\n", num_skipped_windows);
+    }
+
     std::vector<std::shared_ptr<Window>>().swap(windows_);
     std::vector<std::unique_ptr<Sequence>>().swap(sequences_);
 }
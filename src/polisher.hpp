@@ -7,6 +7,7 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
@@ -42,9 +43,15 @@ class Polisher;
 std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
     const std::string& overlaps_path, const std::string& target_path,
     PolisherType type,bool haplotype, double min_confidence, double min_support,
-    uint32_t num_prune, uint32_t window_length, double quality_threshold,
-    double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-    uint32_t num_threads, uint32_t cuda_batches = 0,
+    uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+    double quality_threshold,
+    double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+    int8_t match, int8_t mismatch, int8_t gap,
+    int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+    uint32_t local_xdrop,
+    uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+    uint32_t num_threads, const std::string& save_graphs_path,
+    const std::string& load_graphs_path, uint32_t cuda_batches = 0,
     bool cuda_banded_alignment = false, uint32_t cudaaligner_batches = 0,
     uint32_t cudaaligner_band_width = 0);
 
@@ -60,9 +67,15 @@ public:
     friend std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         const std::string& overlaps_path, const std::string& target_path,
         PolisherType type,bool haplotype,double min_confidence,double min_support,
-        uint32_t num_prune, uint32_t window_length, double quality_threshold,
-        double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-        uint32_t num_threads, uint32_t cuda_batches, bool cuda_banded_alignment,
+        uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+        double quality_threshold,
+        double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+        int8_t match, int8_t mismatch, int8_t gap,
+        int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+        uint32_t local_xdrop,
+        uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+        uint32_t num_threads, const std::string& save_graphs_path,
+        const std::string& load_graphs_path, uint32_t cuda_batches, bool cuda_banded_alignment,
         uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
 
 protected:
@@ -70,12 +83,36 @@ protected:
         std::unique_ptr<bioparser::Parser<Overlap>> oparser,
         std::unique_ptr<bioparser::Parser<Sequence>> tparser,
         PolisherType type,bool haplotype, double min_confidence,double min_support,
-        uint32_t num_prune, uint32_t window_length, double quality_threshold,
-        double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-        uint32_t num_threads);
+        uint32_t num_prune, uint32_t window_length, bool adaptive_windows,
+        double quality_threshold,
+        double error_threshold, bool trim, uint32_t max_depth, double min_agreement,
+        int8_t match, int8_t mismatch, int8_t gap,
+        int8_t local_match, int8_t local_mismatch, int8_t local_gap,
+        uint32_t local_xdrop,
+        uint32_t band_width, bool packed_traceback, uint64_t max_engine_memory,
+        uint32_t num_threads, const std::string& save_graphs_path,
+        const std::string& load_graphs_path);
     Polisher(const Polisher&) = delete;
     const Polisher& operator=(const Polisher&) = delete;
+    // splits each target into windows of balanced estimated POA work
+    void find_window_starts(uint64_t targets_size,
+        const std::vector<std::unique_ptr<Overlap>>& overlaps);
     virtual void find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps);
+    // generates the consensus of window i with the engines of the calling
+    // thread, keeping its backbone if the alignments exceed max_engine_memory_
+    bool generate_consensus(uint64_t i, bool store_graph);
+    // largest sizes of an engine after the windows of the current and of the
+    // previous round of kEngineMemoryRound windows, i.e. a running maximum
+    struct EngineMemory {
+        uint64_t current;
+        uint64_t previous;
+        uint32_t num_windows;
+    };
+    // releases the matrices of an engine that a window grew beyond twice its
+    // recent maximum and returns the size the engine had
+    uint64_t shrink_engine(spoa::AlignmentEngine& engine, EngineMemory& recent);
+    // creates targets and windows from a graph store written by polish
+    void load_graphs();
 
     std::unique_ptr<bioparser::Parser<Sequence>> sparser_;
     std::unique_ptr<bioparser::Parser<Overlap>> oparser_;
@@ -90,13 +127,35 @@ protected:
     double quality_threshold_;
     double error_threshold_;
     bool trim_;
+    // coverage to which the layers of each window are downsampled, 0 if not
+    uint32_t max_depth_;
+    // share of layers identical to the backbone for which POA is skipped
+    double min_agreement_;
+    // pre-pruning window graphs are written to / read from these files
+    std::string save_graphs_path_;
+    std::string load_graphs_path_;
     std::vector<std::shared_ptr<spoa::AlignmentEngine>> alignment_engines_;
+    // local (SW) engines used by the haplotype-aware consensus, per thread
+    std::vector<std::shared_ptr<spoa::AlignmentEngine>> local_alignment_engines_;
+    // engines shrink back after outlier windows so that one large graph does
+    // not keep its matrices for the rest of the run, the largest size per
+    // thread is reported
+    uint64_t max_engine_memory_;
+    std::vector<EngineMemory> engine_memories_;
+    std::vector<EngineMemory> local_engine_memories_;
+    std::vector<uint64_t> engine_memory_peaks_;
+    std::vector<uint64_t> num_skipped_windows_;
+    std::vector<uint64_t> num_agreeing_windows_;
 
     std::vector<std::unique_ptr<Sequence>> sequences_;
     std::vector<uint32_t> targets_coverages_;
     std::string dummy_quality_;
 
     uint32_t window_length_;
+    // window starts of each target, sized by local depth and error when
+    // adaptive_windows_ is set and spaced by window_length_ otherwise
+    bool adaptive_windows_;
+    std::vector<std::vector<uint32_t>> window_starts_;
     std::vector<std::shared_ptr<Window>> windows_;
 
     std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
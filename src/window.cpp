@@ -7,13 +7,47 @@
 #include <algorithm>
 #include <assert.h>
 #include <math.h>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
 #include "window.hpp"
 
 #include "spoa/spoa.hpp"
+#include "cereal/archives/binary.hpp"
+#include "cereal/types/string.hpp"
 
 namespace racon
 {
 
+    namespace
+    {
+        // probability 1 - 10^((33 - c) / 10) that a base with Phred+33
+        // quality character c is correct, and the same scaled to the integer
+        // edge weights of the pruning rounds; characters below '!' weigh 0
+        struct PhredWeights
+        {
+            double probabilities[256];
+            uint32_t weights[256];
+
+            PhredWeights()
+            {
+                for (uint32_t c = 0; c < 256; ++c)
+                {
+                    probabilities[c] = c < 33 ? 0 : 1 - pow(10, (33 - static_cast<int32_t>(c)) / 10.0);
+                    weights[c] = probabilities[c] * 1000;
+                }
+            }
+        };
+
+        const PhredWeights &phred_weights()
+        {
+            static const PhredWeights table;
+            return table;
+        }
+    }
+
     std::shared_ptr<Window> createWindow(uint64_t id, uint32_t rank, WindowType type,
                                          const char *backbone, uint32_t backbone_length, const char *quality,
                                          uint32_t quality_length)
@@ -30,14 +64,66 @@ namespace racon
                                                   backbone_length, quality, quality_length));
     }
 
+    std::shared_ptr<Window> loadWindow(std::istream &in)
+    {
+        cereal::BinaryInputArchive archive(in);
+
+        uint64_t id;
+        uint32_t rank;
+        uint8_t type;
+        uint32_t num_layers;
+        archive(id, rank, type, num_layers);
+
+        // sequence and quality of each layer, empty quality if there is none
+        std::vector<std::string> data(2 * num_layers);
+        std::vector<std::pair<uint32_t, uint32_t>> positions(num_layers);
+        std::vector<bool> has_quality(num_layers);
+        for (uint32_t i = 0; i < num_layers; ++i)
+        {
+            bool is_quality;
+            archive(data[2 * i], data[2 * i + 1], is_quality,
+                    positions[i].first, positions[i].second);
+            has_quality[i] = is_quality;
+        }
+        std::string graph;
+        archive(graph);
+
+        if (num_layers == 0 || data[0].empty() || data[0].size() != data[1].size())
+        {
+            fprintf(stderr, "[racon::loadWindow] error: "
+                            "invalid window record!\n");
+            exit(1);
+        }
+
+        auto window = createWindow(id, rank, static_cast<WindowType>(type),
+                                   data[0].c_str(), data[0].size(), data[1].c_str(), data[1].size());
+        for (uint32_t i = 1; i < num_layers; ++i)
+        {
+            window->sequences_.emplace_back(data[2 * i].c_str(), data[2 * i].size());
+            window->qualities_.emplace_back(has_quality[i] ? data[2 * i + 1].c_str() : nullptr,
+                                            data[2 * i + 1].size());
+            window->positions_.emplace_back(positions[i]);
+            window->strands_.emplace_back(false);
+            window->accuracies_.emplace_back(1.0);
+        }
+        // swapping the vectors keeps the strings, and thus the layer pointers, in place
+        window->data_.swap(data);
+        window->graph_.swap(graph);
+
+        return window;
+    }
+
     Window::Window(uint64_t id, uint32_t rank, WindowType type, const char *backbone,
                    uint32_t backbone_length, const char *quality, uint32_t quality_length)
-        : id_(id), rank_(rank), type_(type), consensus_(), sequences_(),
-          qualities_(), positions_()
+        : id_(id), rank_(rank), type_(type), num_prune_rounds_(0), consensus_(),
+          sequences_(), qualities_(), positions_(), strands_(), accuracies_(),
+          graph_(), data_()
     {
         sequences_.emplace_back(backbone, backbone_length);
         qualities_.emplace_back(quality, quality_length);
         positions_.emplace_back(0, 0);
+        strands_.emplace_back(false);
+        accuracies_.emplace_back(1.0);
     }
 
     Window::~Window()
@@ -45,7 +131,8 @@ namespace racon
     }
 
     void Window::add_layer(const char *sequence, uint32_t sequence_length,
-                           const char *quality, uint32_t quality_length, uint32_t begin, uint32_t end)
+                           const char *quality, uint32_t quality_length, uint32_t begin, uint32_t end,
+                           bool strand, double accuracy)
     {
 
         if (sequence_length == 0 || begin == end)
@@ -69,6 +156,198 @@ namespace racon
         sequences_.emplace_back(sequence, sequence_length);
         qualities_.emplace_back(quality, quality_length);
         positions_.emplace_back(begin, end);
+        strands_.emplace_back(strand);
+        accuracies_.emplace_back(accuracy);
+    }
+
+    bool Window::agrees_with_backbone(double min_agreement) const
+    {
+        uint32_t num_layers = sequences_.size() - 1;
+        if (num_layers < 2)
+        {
+            return false;
+        }
+        uint32_t min_num_agreeing = std::max(2.0, std::ceil(min_agreement * num_layers));
+
+        // layers are compared until the outcome is settled
+        uint32_t num_agreeing = 0;
+        for (uint32_t i = 1; i < sequences_.size(); ++i)
+        {
+            if (num_agreeing >= min_num_agreeing)
+            {
+                return true;
+            }
+            if (num_agreeing + sequences_.size() - i < min_num_agreeing)
+            {
+                return false;
+            }
+            uint32_t length = positions_[i].second - positions_[i].first + 1;
+            if (sequences_[i].second == length &&
+                std::memcmp(sequences_[i].first,
+                            sequences_.front().first + positions_[i].first, length) == 0)
+            {
+                ++num_agreeing;
+            }
+        }
+        return num_agreeing >= min_num_agreeing;
+    }
+
+    uint32_t Window::downsample(uint32_t max_depth)
+    {
+        uint32_t backbone_length = sequences_.front().second;
+        uint64_t max_coverage = static_cast<uint64_t>(max_depth) * backbone_length;
+
+        uint64_t total_coverage = 0;
+        for (uint32_t i = 1; i < sequences_.size(); ++i)
+        {
+            total_coverage += positions_[i].second - positions_[i].first + 1;
+        }
+        if (max_depth == 0 || total_coverage <= max_coverage)
+        {
+            return 0;
+        }
+
+        // spanning as in generate_consensus, i.e. save for 1% at either end
+        uint32_t offset = 0.01 * backbone_length;
+        auto is_spanning = [&](uint32_t i) -> bool {
+            return positions_[i].first < offset &&
+                   positions_[i].second > backbone_length - offset;
+        };
+
+        std::vector<uint32_t> layers[2];
+        for (uint32_t i = 1; i < sequences_.size(); ++i)
+        {
+            layers[strands_[i]].emplace_back(i);
+        }
+        for (auto &it : layers)
+        {
+            std::stable_sort(it.begin(), it.end(), [&](uint32_t lhs, uint32_t rhs) {
+                if (is_spanning(lhs) != is_spanning(rhs))
+                {
+                    return is_spanning(lhs);
+                }
+                return accuracies_[lhs] > accuracies_[rhs];
+            });
+        }
+
+        // the strand with less coverage so far contributes the next layer
+        std::vector<bool> is_kept(sequences_.size(), false);
+        is_kept[0] = true;
+        uint64_t coverages[2] = {0, 0};
+        uint32_t next[2] = {0, 0};
+        while (coverages[0] + coverages[1] < max_coverage)
+        {
+            uint32_t s = coverages[1] < coverages[0] ? 1 : 0;
+            if (next[s] == layers[s].size())
+            {
+                s ^= 1;
+            }
+            uint32_t i = layers[s][next[s]++];
+            is_kept[i] = true;
+            coverages[s] += positions_[i].second - positions_[i].first + 1;
+        }
+
+        // kept layers stay in their order
+        uint32_t num_kept = 0;
+        for (uint32_t i = 0; i < sequences_.size(); ++i)
+        {
+            if (!is_kept[i])
+            {
+                continue;
+            }
+            sequences_[num_kept] = sequences_[i];
+            qualities_[num_kept] = qualities_[i];
+            positions_[num_kept] = positions_[i];
+            strands_[num_kept] = strands_[i];
+            accuracies_[num_kept] = accuracies_[i];
+            ++num_kept;
+        }
+        uint32_t num_dropped = sequences_.size() - num_kept;
+        sequences_.resize(num_kept);
+        qualities_.resize(num_kept);
+        positions_.resize(num_kept);
+        strands_.resize(num_kept);
+        accuracies_.resize(num_kept);
+
+        return num_dropped;
+    }
+
+    void Window::store(std::ostream &out) const
+    {
+        cereal::BinaryOutputArchive archive(out);
+
+        archive(id_, rank_, static_cast<uint8_t>(type_),
+                static_cast<uint32_t>(sequences_.size()));
+        for (uint32_t i = 0; i < sequences_.size(); ++i)
+        {
+            bool is_quality = qualities_[i].first != nullptr;
+            archive(std::string(sequences_[i].first, sequences_[i].second),
+                    is_quality ? std::string(qualities_[i].first, qualities_[i].second) : std::string(),
+                    is_quality, positions_[i].first, positions_[i].second);
+        }
+        archive(graph_);
+    }
+
+    double Window::average_weight() const
+    {
+        //average phred score (or coverage) for bases in all sequences
+        double total_bases_weight = 0.0;
+        std::uint16_t window_len = sequences_.front().second;
+        bool if_fasta = false;
+
+        // bases are counted per quality character and the counts weighted
+        // by 1-p rather than phred score once, in a loop which vectorizes
+        uint64_t counts[256] = {0};
+
+        //the backbone sequence, targets without qualities get a dummy one of '!'
+        const char *backbone_quality = qualities_.front().first;
+        if (std::all_of(backbone_quality, backbone_quality + qualities_.front().second,
+                        [](char c) { return c == '!'; }))
+        {
+            total_bases_weight += sequences_.front().second;
+            if_fasta = true;
+        }
+        else
+        {
+            for (std::uint32_t q = 0; q < qualities_.front().second; ++q)
+            {
+                ++counts[static_cast<uint8_t>(backbone_quality[q])];
+            }
+        }
+
+        for (uint32_t i = 1; i < sequences_.size(); ++i)
+        {
+            if (qualities_[i].first == nullptr)
+            {
+                total_bases_weight += sequences_[i].second;
+            }
+            else
+            {
+                for (std::uint32_t q = 0; q < qualities_[i].second; ++q)
+                {
+                    ++counts[static_cast<uint8_t>(qualities_[i].first[q])];
+                }
+            }
+        }
+
+        const auto &probabilities = phred_weights().probabilities;
+        double quality_weights[4] = {0};
+        for (uint32_t c = 0; c < 256; c += 4)
+        {
+            for (uint32_t l = 0; l < 4; ++l)
+            {
+                quality_weights[l] += counts[c + l] * probabilities[c + l];
+            }
+        }
+        total_bases_weight += (quality_weights[0] + quality_weights[1]) +
+                              (quality_weights[2] + quality_weights[3]);
+
+        if (if_fasta)
+        {
+            return 2.0 * total_bases_weight / window_len; // fasta
+        }
+        //2 * average coverage if no quality * factor (to suit uint)
+        return 2.0 * total_bases_weight / window_len * 1000;
     }
 
     bool Window::generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
@@ -81,7 +360,9 @@ namespace racon
             return false;
         }
 
-        spoa::Graph graph{};
+        // sequence labels are only needed for the coverages used in trimming
+        bool is_trimmed = type_ == WindowType::kTGS && trim;
+        spoa::Graph graph(is_trimmed);
         graph.AddAlignment(
             spoa::Alignment(),
             sequences_.front().first, sequences_.front().second,
@@ -97,27 +378,29 @@ namespace racon
         std::sort(rank.begin() + 1, rank.end(), [&](uint32_t lhs, uint32_t rhs) { return positions_[lhs].first < positions_[rhs].first; });
 
         uint32_t offset = 0.01 * sequences_.front().second;
+        spoa::Graph::View subgraph;
+        spoa::Alignment alignment;
         for (uint32_t j = 1; j < sequences_.size(); ++j)
         {
             uint32_t i = rank[j];
 
-            spoa::Alignment alignment;
             if (positions_[i].first < offset && positions_[i].second >
                                                     sequences_.front().second - offset)
             {
-                alignment = alignment_engine->Align(
-                    sequences_[i].first, sequences_[i].second, graph);
+                alignment_engine->Align(
+                    sequences_[i].first, sequences_[i].second, graph,
+                    &alignment);
             }
             else
             {
-                std::vector<const spoa::Graph::Node *> mapping;
-                auto subgraph = graph.Subgraph(
+                // partial layers are aligned in place to the subgraph they span
+                graph.SubgraphView(
                     positions_[i].first,
                     positions_[i].second,
-                    &mapping);
-                alignment = alignment_engine->Align(
-                    sequences_[i].first, sequences_[i].second, subgraph);
-                subgraph.UpdateAlignment(mapping, &alignment);
+                    &subgraph);
+                alignment_engine->Align(
+                    sequences_[i].first, sequences_[i].second, subgraph,
+                    &alignment);
             }
 
             if (qualities_[i].first == nullptr)
@@ -136,9 +419,10 @@ namespace racon
         }
 
         std::vector<uint32_t> coverages;
-        consensus_ = graph.GenerateConsensus(&coverages);
+        consensus_ = is_trimmed ? graph.GenerateConsensus(&coverages) :
+            graph.GenerateConsensus();
 
-        if (type_ == WindowType::kTGS && trim)
+        if (is_trimmed)
         {
             uint32_t average_coverage = (sequences_.size() - 1) / 2;
 
@@ -174,8 +458,9 @@ namespace racon
     }
 
     bool Window::generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
+                                    std::shared_ptr<spoa::AlignmentEngine> local_alignment_engine,
                                     bool trim, bool haplotype,double min_confidence,double min_support,
-                                    std::uint32_t num_prune)
+                                    std::uint32_t num_prune, bool store_graph)
     {
         // std::cerr << "Using --haplotype for error correction !!! " << std::endl;
         //function overloading
@@ -194,12 +479,6 @@ namespace racon
         //std::cerr << "Debug_first: "<<qualities_.front().first<<"\n";
         //std::cerr << "Debug_second: "<<qualities_.front().second<<"\n";
 
-        spoa::Graph graph{};
-        graph.AddAlignment(
-            spoa::Alignment(),
-            sequences_.front().first, sequences_.front().second,
-            qualities_.front().first, qualities_.front().second);
-
         std::vector<uint32_t> rank;
         rank.reserve(sequences_.size());
         for (uint32_t i = 0; i < sequences_.size(); ++i)
@@ -210,104 +489,105 @@ namespace racon
         std::sort(rank.begin() + 1, rank.end(), [&](uint32_t lhs, uint32_t rhs) { return positions_[lhs].first < positions_[rhs].first; });
 
         uint32_t offset = 0.01 * sequences_.front().second;
-        // the original POA graph construction
-        double average_weight; //average phred score (or coverage) for bases in all sequences
-        double total_bases_weight = 0.0;
-        std::uint16_t window_len = sequences_.front().second;
-        bool if_fasta = false;
-
-        //the backbone sequence
-        //std::cerr << "Debug, front: "<<qualities_.front().first<<"\n";
+        double average_weight = this->average_weight();
 
-        //if (qualities_.front().first == nullptr)
-        if (qualities_.front().first == std::string(qualities_.front().second,'!'))
-        {
-            total_bases_weight += sequences_.front().second;
-            if_fasta = true;
-            //std::cerr << "YES, backbone FASTA mode running...\n";
-        }
-        else
+        // edge weights of each layer, the same in the POA build and every
+        // pruning round
+        std::vector<std::vector<uint32_t>> weights(sequences_.size());
+        for (uint32_t i = 0; i < sequences_.size(); ++i)
         {
-            //std::cerr << "YES, backbone FASTQ mode running...\n";
-            for (std::uint16_t q = 0; q < qualities_.front().second; ++q)
+            if (qualities_[i].first == nullptr)
             {
-                //total_bases_weight += qualities_.front().first[q] - 33;
-                total_bases_weight += 1 - pow(10,(33 - qualities_.front().first[q])/10.0); //1-p rather than phred score
+                weights[i].assign(sequences_[i].second, 1);
+            }
+            else
+            { // consider quality score, 1-p scaled by 1000
+                const auto &table = phred_weights().weights;
+                weights[i].resize(sequences_[i].second);
+                for (std::uint32_t n = 0; n < sequences_[i].second; ++n)
+                {
+                    weights[i][n] = table[static_cast<uint8_t>(qualities_[i].first[n])];
+                }
             }
         }
 
-        for (uint32_t j = 1; j < sequences_.size(); ++j) //j starts from 1, the 0th is the backbone
+        // pruning works on edge weights only, sequence labels are not needed
+        spoa::Graph graph(false);
+        if (!graph_.empty())
         {
-            uint32_t i = rank[j];
+            // graph built and stored by an earlier run
+            std::istringstream is(graph_);
+            cereal::BinaryInputArchive archive(is);
+            archive(graph);
+        }
+        else
+        {
+            // the original POA graph construction
+            spoa::Graph::View subgraph;
+            spoa::Alignment alignment;
+            graph.AddAlignment(
+                spoa::Alignment(),
+                sequences_.front().first, sequences_.front().second,
+                weights.front());
 
-            //sequences_.first is the subsequence(starts from the current window to the end of read)
-            //sequences_.second is the length of window-sequence, say ~500. so does qualities_
-            //so the real sequence for current window is: seq[0:seqlen] =
-            //std::string(sequences_[i].first).substr(0,sequences_[i].second)
+            for (uint32_t j = 1; j < sequences_.size(); ++j) //j starts from 1, the 0th is the backbone
+            {
+                uint32_t i = rank[j];
 
-            // std::cerr << i << " sequences str = " << sequences_[i].first << std::endl;
-            // std::cerr << i << " qualities len= " << qualities_[i].second << std::endl;
-            // std::cerr << i << " qualities str= " << qualities_[i].first << std::endl;
+                //sequences_.first is the subsequence(starts from the current window to the end of read)
+                //sequences_.second is the length of window-sequence, say ~500. so does qualities_
+                //so the real sequence for current window is: seq[0:seqlen] =
+                //std::string(sequences_[i].first).substr(0,sequences_[i].second)
 
-            spoa::Alignment alignment;
-            if (positions_[i].first < offset && positions_[i].second >
-                                                    sequences_.front().second - offset)
-            {
-                alignment = alignment_engine->Align(
-                    sequences_[i].first, sequences_[i].second,
-                    graph);
-            }
-            else
-            {
-                // I guess this is used when the sequence to be aligned is short (NGS or ends of long read)
-                // such that it is not good to perform global alignment on the whole POA graph,
-                // but it is fine if only on the subgraph covered by the target sequence.
-                std::vector<const spoa::Graph::Node *> mapping;
-                auto subgraph = graph.Subgraph(
-                    positions_[i].first,
-                    positions_[i].second,
-                    &mapping);
-                alignment = alignment_engine->Align(
-                    sequences_[i].first, sequences_[i].second,
-                    subgraph);
-                //replace the node IDs(first column, subgraph) in the alignment
-                // with the node IDs in the original graph
-                subgraph.UpdateAlignment(mapping, &alignment);
-            }
+                // std::cerr << i << " sequences str = " << sequences_[i].first << std::endl;
+                // std::cerr << i << " qualities len= " << qualities_[i].second << std::endl;
+                // std::cerr << i << " qualities str= " << qualities_[i].first << std::endl;
+
+                if (positions_[i].first < offset && positions_[i].second >
+                                                        sequences_.front().second - offset)
+                {
+                    alignment_engine->Align(
+                        sequences_[i].first, sequences_[i].second,
+                        graph, &alignment);
+                }
+                else
+                {
+                    // I guess this is used when the sequence to be aligned is short (NGS or ends of long read)
+                    // such that it is not good to perform global alignment on the whole POA graph,
+                    // but it is fine if only on the subgraph covered by the target sequence.
+                    // the alignment to the view holds node IDs of the original graph
+                    graph.SubgraphView(
+                        positions_[i].first,
+                        positions_[i].second,
+                        &subgraph);
+                    alignment_engine->Align(
+                        sequences_[i].first, sequences_[i].second,
+                        subgraph, &alignment);
+                }
 
-            if (qualities_[i].first == nullptr)
-            {
-                graph.AddAlignment(
-                    alignment,
-                    sequences_[i].first, sequences_[i].second);
-                total_bases_weight += sequences_[i].second;
-            }
-            else
-            {
                 graph.AddAlignment(
                     alignment,
                     sequences_[i].first, sequences_[i].second,
-                    qualities_[i].first, qualities_[i].second);
+                    weights[i]);
+            }
 
-                for (std::uint16_t q = 0; q < qualities_[i].second; ++q)
+            if (store_graph)
+            {
+                std::ostringstream os;
                 {
-                    //total_bases_weight += qualities_[i].first[q] - 33;
-                    total_bases_weight += (1 - pow(10,(33 - qualities_[i].first[q])/10.0)); //1-p
+                    cereal::BinaryOutputArchive archive(os);
+                    archive(graph);
                 }
+                graph_ = os.str();
             }
         }
-
-        // start to prune the graph
-        if (if_fasta)
+        // the stored graph is only kept if it is going to be written out
+        if (!store_graph)
         {
-           // std::cerr << "YES, FASTA mode running...\n";
-            average_weight = 2.0 * total_bases_weight / window_len; // fasta
-        }
-        else{
-            //std::cerr << "YES, FASTQ mode running...\n";
-            average_weight = 2.0 * total_bases_weight / window_len * 1000; //2 * average coverage if no quality * factor (to suit uint)
+            std::string().swap(graph_);
         }
 
+        // start to prune the graph
         int64_t min_weight = 0; //deprecated metric 
         // int64_t min_weight = 5 * 2;
         // double min_confidence = 0.19;
@@ -316,84 +596,88 @@ namespace racon
 
         //std::cerr << "Pruning_graph_1"<< "\n";
         graph.PruneGraph(min_weight, min_confidence, min_support, average_weight);
-        spoa::Graph *ptr = new spoa::Graph(graph.LargestSubgraph());
-
-        graph.Clear();
+        // the largest component replaces the graph in place
+        graph.KeepLargestSubgraph();
+        num_prune_rounds_ = 1;
 
         // prune graph for multiple times
         // use local alignment for pruned subgraph rather than global-alignment(may crash due to pruned nodes)
 
-        auto local_alignment_engine = spoa::AlignmentEngine::Create(spoa::AlignmentType::kSW, 3, -5, -4);
-        spoa::Graph *ptr_tmp = nullptr;
+        // alignments to the pruned subgraph are kept between rounds; pruning
+        // only removes edges and nodes, so an alignment whose path survived
+        // is projected onto the new subgraph instead of being recomputed
+        std::vector<spoa::Alignment> alignments(sequences_.size());
 
-        for (std::uint32_t k = 0; k < num_prune - 1; k++)
+        for (std::uint32_t k = 0; k + 1 < num_prune; k++)
         {
             //std::cerr << "Pruning_graph_" << 2 << "th...\n";
-            // re-align sequences to the pruned subgraph and prune graph iteratively
+            // re-align sequences to the pruned subgraph and prune graph iteratively;
+            // adding weights only follows existing edges, so the subgraph is fixed
+            // within a round and the layers are aligned to it in batches first
+            std::vector<uint32_t> global_ids, local_ids;
             for (uint32_t j = 0; j < sequences_.size(); ++j)
             {
                 uint32_t i = rank[j];
-
-                spoa::Alignment alignment;
-                if (j == 0 || (positions_[i].first < offset &&
-                               positions_[i].second > sequences_.front().second - offset))
+                if (k == 0 || !graph.ProjectAlignment(&alignments[i]))
                 {
-                    alignment = alignment_engine->Align(
-                        sequences_[i].first, sequences_[i].second, *ptr);
-                }
-                else
-                {
-                    //local alignment since raw sequences may be partially aligned to pruned subgraph
-                    alignment = local_alignment_engine->Align(
-                        sequences_[i].first, sequences_[i].second, *ptr);
-                }
-
-                std::vector<std::uint32_t> weights;
-                if (qualities_[i].first == nullptr)
-                {
-                    //std::cerr << "YES, FASTA mode running, round2...\n";
-                    for (std::uint32_t n = 0; n < sequences_[i].second; ++n)
+                    if (j == 0 || (positions_[i].first < offset &&
+                                   positions_[i].second > sequences_.front().second - offset))
                     {
-                        weights.emplace_back(1);
+                        global_ids.emplace_back(i);
                     }
-                }
-                else
-                { // consider quality score
-                    //std::cerr << "YES, FASTQ mode running, round2...\n";
-                    for (std::uint32_t n = 0; n < sequences_[i].second; ++n)
+                    else
                     {
-                        //std::uint32_t weight = static_cast<std::uint32_t>(qualities_[i].first[n]) - 33; //phred score,potential bug using 'uint - int'
-                        std::uint32_t weight = (1 - pow(10,(33-qualities_[i].first[n])/10.0))*1000; 
-                        //assert(weight>=0);
-                   
-                        weights.emplace_back(weight);
-                        //std::cerr << "round2: weight: "<<  33-qualities_[i].first[n]<<"\t"<<weight<<std::endl;
+                        //local alignment since raw sequences may be partially aligned to pruned subgraph
+                        local_ids.emplace_back(i);
                     }
                 }
-                (*ptr).AddWeights(alignment, sequences_[i].first, sequences_[i].second, weights);
+            }
+            auto realign = [&](spoa::AlignmentEngine *engine, const std::vector<uint32_t> &ids) -> void
+            {
+                std::vector<std::pair<const char *, uint32_t>> batch;
+                for (const auto &it : ids)
+                {
+                    batch.emplace_back(sequences_[it]);
+                }
+                auto batch_alignments = engine->Align(batch, graph);
+                for (uint32_t n = 0; n < ids.size(); ++n)
+                {
+                    alignments[ids[n]] = std::move(batch_alignments[n]);
+                }
+            };
+            realign(alignment_engine.get(), global_ids);
+            realign(local_alignment_engine.get(), local_ids);
+
+            for (uint32_t j = 0; j < sequences_.size(); ++j)
+            {
+                uint32_t i = rank[j];
+
+                const spoa::Alignment &alignment = alignments[i];
+                graph.AddWeights(alignment, sequences_[i].first, sequences_[i].second, weights[i]);
             }
 
             // std::cerr << "testing breakpoint:" << largestsubgraph.edges().size() << std::endl;
             // std::cerr << "Pruning_graph_23"<< "\n";
-            (*ptr).PruneGraph(min_weight, min_confidence, min_support, average_weight);
-
-            // spoa::Graph largestsubgraph2{};
-            // largestsubgraph2 = largestsubgraph.LargestSubgraph();
-            ptr_tmp = new spoa::Graph((*ptr).LargestSubgraph());
-            delete ptr;
-            ptr = ptr_tmp;
-            ptr_tmp = nullptr;
+            std::uint32_t num_pruned_edges = graph.PruneGraph(
+                min_weight, min_confidence, min_support, average_weight);
+            graph.KeepLargestSubgraph();
+            ++num_prune_rounds_;
+
+            // without pruned edges the component, the projected alignments
+            // and thus the next round are identical, stop early
+            if (num_pruned_edges == 0)
+            {
+                break;
+            }
         }
 
         // generate the haplotype aware corrected sequence
         //the length of the target sequence would not be shorter than the length of subgraph
         //thus local alignment is more suitable
         auto alignment = local_alignment_engine->Align(
-            sequences_.front().first, sequences_.front().second, *ptr);
+            sequences_.front().first, sequences_.front().second, graph);
 
-        consensus_ = (*ptr).GenerateCorrectedSequence(alignment);
-        delete ptr;
-        ptr = nullptr;
+        consensus_ = graph.GenerateCorrectedSequence(alignment);
         // std::cerr << ">Window consensus: " << consensus_ << std::endl;
 
         trim = false;
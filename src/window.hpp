@@ -7,6 +7,7 @@
 #pragma once
 
 #include <stdlib.h>
+#include <iosfwd>
 #include <vector>
 #include <memory>
 #include <string>
@@ -28,6 +29,10 @@ std::shared_ptr<Window> createWindow(uint64_t id, uint32_t rank, WindowType type
     const char* backbone, uint32_t backbone_length, const char* quality,
     uint32_t quality_length);
 
+// creates a window, together with its layers and graph, from a record
+// written by Window::store
+std::shared_ptr<Window> loadWindow(std::istream& in);
+
 class Window {
 
 public:
@@ -44,19 +49,54 @@ public:
         return consensus_;
     }
 
+    // number of pruning rounds used by the haplotype-aware consensus
+    uint32_t num_prune_rounds() const {
+        return num_prune_rounds_;
+    }
+
     bool generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
         bool trim);
     bool generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
+        std::shared_ptr<spoa::AlignmentEngine> local_alignment_engine,
         bool trim, bool haplotype,double min_confidence,double min_support,
-        std::uint32_t num_prune);
-        
+        std::uint32_t num_prune, bool store_graph = false);
+
+    // whether at least min_agreement of the layers (and at least two) are
+    // identical to the part of the backbone they span, in which case POA
+    // would follow them to the backbone
+    bool agrees_with_backbone(double min_agreement) const;
+
+    // uses the backbone as consensus, e.g. if the alignments of the layers
+    // do not fit the engines
+    void keep_backbone() {
+        consensus_ = std::string(sequences_.front().first, sequences_.front().second);
+    }
+
+    // writes the window, its layers and (if kept by generate_consensus with
+    // store_graph) the graph built before pruning, so that pruning can later
+    // be rerun with other parameters without redoing the alignments
+    void store(std::ostream& out) const;
+
+    // strand and accuracy (estimated from the overlap error and the base
+    // qualities) rank the layer in downsample
     void add_layer(const char* sequence, uint32_t sequence_length,
         const char* quality, uint32_t quality_length, uint32_t begin,
-        uint32_t end);
+        uint32_t end, bool strand = false, double accuracy = 1.0);
+
+    // drops layers beyond max_depth times the backbone length, keeping
+    // full-spanning layers first and then those of higher accuracy while
+    // both strands take turns by coverage; returns the number of dropped
+    // layers
+    uint32_t downsample(uint32_t max_depth);
+
+    uint32_t num_layers() const {
+        return sequences_.size() - 1;
+    }
 
     friend std::shared_ptr<Window> createWindow(uint64_t id, uint32_t rank,
         WindowType type, const char* backbone, uint32_t backbone_length,
         const char* quality, uint32_t quality_length);
+    friend std::shared_ptr<Window> loadWindow(std::istream& in);
 
 #ifdef CUDA_ENABLED
     friend class CUDABatchProcessor;
@@ -67,13 +107,22 @@ private:
     Window(const Window&) = delete;
     const Window& operator=(const Window&) = delete;
 
+    double average_weight() const;
+
     uint64_t id_;
     uint32_t rank_;
     WindowType type_;
+    uint32_t num_prune_rounds_;
     std::string consensus_;
     std::vector<std::pair<const char*, uint32_t>> sequences_;
     std::vector<std::pair<const char*, uint32_t>> qualities_;
     std::vector<std::pair<uint32_t, uint32_t>> positions_;
+    std::vector<bool> strands_;
+    std::vector<double> accuracies_;
+    // serialized graph before pruning
+    std::string graph_;
+    // layers of windows created by loadWindow
+    std::vector<std::string> data_;
 };
 
 }